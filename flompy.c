@@ -10,11 +10,25 @@
 // Compiled with Open Watcom, 16-Bit real mode, large memory model
 // http://openwatcom.org
 //
+// Can also be compiled for Linux with GCC,
+// using the kernel floppy driver's FDRAWCMD interface instead of the FDC ports.
+//
 
+#ifdef __linux__
+#include <fcntl.h>        // open
+#include <strings.h>      // strcasecmp
+#include <sys/ioctl.h>    // ioctl
+#include <poll.h>         // poll
+#include <termios.h>      // tcsetattr
+#include <linux/fd.h>     // FDRAWCMD, FDRESET, FDSETDRVPRM
+#define stricmp strcasecmp
+#else
 #include <bios.h>     // _bios_disk
 #include <conio.h>    // inp, outp
 #include <dos.h>      // _dos_getvect, _dos_setvect
 #include <i86.h>      // _interrupt, _disable, _enable
+#endif
+#include <errno.h>
 #include <limits.h>   // INT_MIN, INT_MAX
 #include <stdio.h>
 #include <stdint.h>
@@ -31,17 +45,48 @@ const int VERSION = 1;
 #define HIGH_RETRIES   8
 
 // maximum track size for low level read buffer
+#ifdef __linux__
+// (largest single ISA DMA transfer, keep this equal to MAX_TRACK_SIZE in flompy.py)
+#define MAX_TRACK_SIZE   65535
+#else
 // (chosen so that MAX_TRACK_SIZE * 2 < 64k so timing can fit in a segment)
 // keep this equal to MAX_TRACK_SIZE in flompirq.asm
 #define MAX_TRACK_SIZE   31000
+#endif
 
 // timeout for low level IRQ in system clock ticks (~18 times per second)
 #define LOW_TIMEOUT   (10*18)
 
+// DOS needs the FDC reset and IRQ reinstalled for each track read in a full dump,
+// the Linux driver does not
+#ifdef __linux__
+#define LOW_REOPEN   0
+#else
+#define LOW_REOPEN   1
+#endif
+
 // number of retries for low level seek and read operations
 #define SEEK_RETRIES   8
 #define READ_RETRIES   4
 
+// serial link timeout for a reply or the rest of a packet, in system clock ticks
+#define LINK_TIMEOUT   (10*18)
+
+// how long the receiver waits for the sender's next packet before giving up
+#ifndef LINK_IDLE
+#define LINK_IDLE   (5*60*18)
+#endif
+
+// number of times a link packet is resent, and re-read requests per track
+#define LINK_RETRIES   4
+#define LINK_REREADS   4
+
+// most sectors named in reply to a track, so the reply fits a 16550A's 16 byte FIFO
+#define LINK_REREAD_FIFO   12
+
+// how far past a sector ID to search for its data address mark, in bytes
+#define LINK_DATA_SEARCH   64
+
 // Exit codes, later versions may append to but not reorder this list
 enum {
 	RESULT_SUCCESS  = 0, // success
@@ -55,6 +100,7 @@ enum {
 	RESULT_FATAL    = 8, // fatal error, no output produced
 	RESULT_MEMORY   = 9, // out of memory
 	RESULT_LOW      = 10, // unable to begin low level control
+	RESULT_LINK     = 11, // unable to open or communicate over serial link
 };
 
 typedef uint32_t     uint32;
@@ -77,6 +123,7 @@ int rate_step = 13; // default suggested as "typical" by fdrawcmd
 int rate_load = 15; // ''
 int rate_unload = 1; // ''
 const char* filename = NULL;
+const char* linkname = NULL;
 
 // parameters auto-detected from boot sector
 int boot_sector_bytes = -1;
@@ -96,9 +143,17 @@ uint16* lowtime = NULL; // timing values
 int lowtime_on = 0;
 int lowport;
 
+#ifdef __linux__
+int fdd = -1; // floppy device file
+struct floppy_raw_cmd rawcmd;
+struct floppy_drive_params drive_params_old;
+int drive_params_set = 0;
+int drive_params_warned = 0;
+#else
 uint8 pic0_mask_old;
 void (__interrupt __far *floppy_irq_old)() = NULL;
 volatile int floppy_irq_wait;
+#endif
 uint8 floppy_st0;
 uint8 floppy_st1;
 uint8 floppy_st2;
@@ -107,11 +162,31 @@ uint8 floppy_h;
 uint8 floppy_r;
 uint8 floppy_n;
 
+// serial link
+#ifdef __linux__
+int linkfd = -1;
+#else
+uint linkport = 0; // UART base port
+#endif
+int linkfifo = 1; // a reply can wait unread while the sender reads the next side
+uint16 link_crc;
+int link_c; // track and side of last packet received
+int link_h;
+int link_count; // sector count of last sector or re-read packet
+uint8 linkreread[256]; // sectors named by a re-read request
+uint8* linkimage = NULL; // receiver's decoded sectors for the current track
+uint8* linkdata = NULL; // receiver's incoming packet, until its CRC is checked
+uint8* linkcapture = NULL; // sender's captures of both sides of a cylinder
+uint linkcapture_pos[2];
+uint8 linkgood[256]; // receiver's sectors that passed CRC
+
 //
 // misc functions
 //
 
 void open_output(); // exit(RESULT_OUTPUT) if file could not be opened
+void link_close();
+void low_close();
 
 void* get_memory(size_t size) // exit(RESULT_MEMORY) if could not be allocated
 {
@@ -129,6 +204,18 @@ void free_all()
 	if (f != NULL) fclose(f);
 	free(lowdata); lowdata = NULL;
 	free(lowtime); lowtime = NULL;
+	free(linkimage); linkimage = NULL;
+	free(linkdata); linkdata = NULL;
+	free(linkcapture); linkcapture = NULL;
+	link_close();
+#ifdef __linux__
+	if (fdd >= 0)
+	{
+		low_close(); // restores the driver's timings if a mode returned early
+		close(fdd);
+	}
+	fdd = -1;
+#endif
 }
 
 void printparam(int p) // for unspecified parameter diagnostic
@@ -155,7 +242,6 @@ void dump(const uint8* buffer, int length) // dump hex
 //
 
 const char* const UNKNOWN_HIGH_ERROR = "Unknown INT 13h error";
-struct diskinfo_t diskinfo;
 
 typedef struct { uint8 code; const char* const text; } BiosErrorCode;
 const BiosErrorCode HIGH_ERROR[] = {
@@ -197,6 +283,108 @@ const char* high_error(uint8 e)
 	return UNKNOWN_HIGH_ERROR;
 };
 
+#ifdef __linux__
+
+// The kernel floppy driver takes a whole FDC command at once,
+// waits for its interrupt, and returns the result bytes.
+// When waiting for the interrupt of a command with no result phase (seek, calibrate)
+// the driver issues the sense interrupt status command (08) for us.
+
+int floppy_ioctl_kernel(int fd, unsigned long request, void* arg)
+{
+	return ioctl(fd, request, arg);
+}
+
+// all driver requests go through here, so tests can substitute a fake FDC
+int (*floppy_ioctl)(int fd, unsigned long request, void* arg) = floppy_ioctl_kernel;
+
+void rawcmd_begin(int flags, int track, void* data, long length)
+{
+	memset(&rawcmd, 0, sizeof(rawcmd));
+	rawcmd.flags = flags;
+	rawcmd.track = track;
+	rawcmd.data = data;
+	rawcmd.length = length;
+	rawcmd.rate = datarate;
+}
+
+void rawcmd_write(uint8 value)
+{
+	if (rawcmd.cmd_count < FD_RAW_CMD_SIZE) rawcmd.cmd[rawcmd.cmd_count++] = value;
+}
+
+uint8 rawcmd_read(int index) // result byte, 0xFF if not returned
+{
+	if (index >= rawcmd.reply_count) return 0xFF;
+	return rawcmd.reply[index];
+}
+
+int rawcmd_send()
+{
+	if (floppy_ioctl(fdd, FDRAWCMD, &rawcmd) < 0) return -1;
+	if (rawcmd.flags & FD_RAW_HARDFAILURE) return -1; // timeout or FDC reset
+	return 0;
+}
+
+uint8 high_fdc_error() // translate read data result to a BIOS error code
+{
+	uint8 st0 = rawcmd_read(0);
+	uint8 st1 = rawcmd_read(1);
+	uint8 st2 = rawcmd_read(2);
+	if (rawcmd.reply_count < 7) return 0x80;
+	if ((st0 & 0xC0) == 0) return 0x00;
+	if ((st1 & 0x20) || (st2 & 0x20)) return 0x10; // CRC error in ID or data
+	if ((st1 & 0x01) || (st2 & 0x01)) return 0x02; // missing address mark
+	if (st1 & 0x02) return 0x03; // write protected
+	if (st1 & 0x10) return 0x08; // overrun
+	if ((st1 & 0x84) || (st2 & 0x12)) return 0x04; // no data, end of cylinder, wrong cylinder
+	return 0x20;
+}
+
+uint8 high_reset()
+{
+	char name[16];
+	sprintf(name, "/dev/fd%d", device + (fdc_port * 4)); // second controller is fd4-7
+	if (fdd < 0) fdd = open(name, O_RDWR | O_NDELAY);
+	if (fdd < 0)
+	{
+		fprintf(stderr,"\nUnable to open %s: %s\n", name, strerror(errno));
+		return 0xAA;
+	}
+	if (floppy_ioctl(fdd, FDRESET, (void*)(long)FD_RESET_ALWAYS) < 0) return 0x05;
+	return 0x00;
+}
+
+uint8 high_read_sector(int track, int side, int sector)
+{
+	uint8 result = 0x80;
+	int bytes = (sector_bytes < 0) ? 512 : sector_bytes;
+	int n = 0;
+	int i;
+	while ((128 << n) < bytes) ++n;
+	memset(highdata, fill & 0xFF, sizeof(highdata));
+	for (i=0; i < HIGH_RETRIES; ++i)
+	{
+		rawcmd_begin(FD_RAW_READ | FD_RAW_INTR | FD_RAW_NEED_SEEK | FD_RAW_SPIN, track, highdata, bytes);
+		rawcmd_write((encoding << 6) | 0x06); // read data
+		rawcmd_write((side << 2) | device);
+		rawcmd_write(track);
+		rawcmd_write(side);
+		rawcmd_write(sector);
+		rawcmd_write(n);
+		rawcmd_write(sector); // last sector
+		rawcmd_write(0x1B); // gap length
+		rawcmd_write(0xFF); // data length
+		result = rawcmd_send() ? 0x80 : high_fdc_error();
+		if (result == 0) break;
+	}
+	return result;
+}
+
+#else
+
+struct diskinfo_t diskinfo;
+
 uint8 high_retry(unsigned service) // retries a BIOS operation multiple times or until success
 {
 	uint8 result;
@@ -232,6 +420,8 @@ uint8 high_read_sector(int track, int side, int sector)
 	return high_retry(_DISK_READ);
 }
 
+#endif
+
 uint16 high16(int pos) // fetch 16-bit little-endian value from highdata
 {
 	return (highdata[pos+0] << 0)
@@ -253,6 +443,8 @@ enum {
 	LOW_SEEK,
 	LOW_TRACK_TIMEOUT,
 	LOW_EMPTY,
+	LOW_ID_TIMEOUT,
+	LOW_ID,
 	LOW_COUNT
 };
 
@@ -265,6 +457,8 @@ const char* const LOW_ERROR[LOW_COUNT] = {
 	"Seek failure",
 	"Read track IRQ timeout",
 	"No data read from track",
+	"Read ID IRQ timeout",
+	"No sector ID found",
 };
 
 const char* low_error(uint8 e)
@@ -273,6 +467,156 @@ const char* low_error(uint8 e)
 	return LOW_ERROR[e];
 }
 
+#ifdef __linux__
+
+void delay(uint ticks) // delay in ~1/18 second ticks
+{
+	for (; ticks>0; --ticks) usleep(54925);
+}
+
+const uint DATARATE_KBPS[4] = { 500, 300, 250, 1000 };
+
+void low_close()
+{
+	// the driver turns off the motor after a few seconds of inactivity
+	if (drive_params_set) floppy_ioctl(fdd, FDSETDRVPRM, &drive_params_old);
+	drive_params_set = 0;
+}
+
+uint8 low_open()
+{
+	int i;
+	uint dtr = DATARATE_KBPS[datarate];
+	struct floppy_drive_params params;
+
+	if (fdd < 0) return LOW_RESET;
+
+	// Set timing parameters through the driver, which issues its own specify command
+	// and keeps DMA mode the way it needs. The driver converts these times back to
+	// specify fields at the current data rate, giving the same values as the DOS version:
+	// -o step rate, -l in the head unload field, -u in the head load field.
+	// Setting them needs root, without it the driver's own timings are used.
+	if (floppy_ioctl(fdd, FDGETDRVPRM, &params) < 0)
+	{
+		fprintf(stderr,"\nUnable to get drive parameters: %s\n", strerror(errno));
+		return LOW_RESET;
+	}
+	if (!drive_params_set) drive_params_old = params;
+	params.srt = ((16 - rate_step) * 500000UL) / dtr; // microseconds
+	params.hut = (rate_load * 8000UL) / dtr; // milliseconds
+	params.hlt = (rate_unload * 1000UL) / dtr; // milliseconds
+	if (floppy_ioctl(fdd, FDSETDRVPRM, &params) == 0) drive_params_set = 1;
+	else if (errno == EPERM || errno == EACCES)
+	{
+		if (!drive_params_warned)
+		{
+			fprintf(stderr,"\nWarning: drive timings not set without root, -o -l -u ignored.\n");
+			drive_params_warned = 1;
+		}
+	}
+	else
+	{
+		fprintf(stderr,"\nUnable to set drive parameters: %s\n", strerror(errno));
+		return LOW_RESET;
+	}
+
+	// calibrate, driver turns on the motor and waits for spin up
+	for (i=0; i < SEEK_RETRIES; ++i)
+	{
+		rawcmd_begin(FD_RAW_INTR | FD_RAW_SPIN, 0, NULL, 0);
+		rawcmd_write(0x07);
+		rawcmd_write(device);
+		if (rawcmd_send())
+		{
+			low_close();
+			return LOW_CALIBRATE_TIMEOUT;
+		}
+		floppy_st0 = rawcmd_read(0);
+		floppy_c   = rawcmd_read(1);
+		if (floppy_c == 0) break;
+	}
+	if (floppy_c != 0)
+	{
+		low_close();
+		return LOW_CALIBRATE;
+	}
+
+	return LOW_SUCCESS;
+}
+
+uint8 low_read_track(int track, int side)
+{
+	int i;
+
+	// seek to track
+	for (i=0; i < SEEK_RETRIES; ++i)
+	{
+		rawcmd_begin(FD_RAW_INTR, 0, NULL, 0);
+		rawcmd_write(0x0F);
+		rawcmd_write((side << 2) | device);
+		rawcmd_write(track);
+		if (rawcmd_send()) return LOW_SEEK_TIMEOUT;
+		floppy_st0 = rawcmd_read(0);
+		floppy_c   = rawcmd_read(1);
+		if (floppy_c == track) break;
+	}
+	if (floppy_c != track)
+	{
+		return LOW_SEEK;
+	}
+	delay(3); // let the head settle
+
+	// read track, see the DOS version below for parameters
+	lowpos = 0;
+	for (i=0; lowpos==0 && i<READ_RETRIES; ++i)
+	{
+		rawcmd_begin(FD_RAW_READ | FD_RAW_INTR | FD_RAW_SPIN, track, lowdata, MAX_TRACK_SIZE); // motor may have timed out
+		rawcmd_write((encoding << 6) | 0x02);
+		rawcmd_write((side << 2) | device);
+		rawcmd_write(track);
+		rawcmd_write(side);
+		rawcmd_write(0);
+		rawcmd_write(0x07);
+		rawcmd_write(0xFF);
+		rawcmd_write(0);
+		rawcmd_write(0xFF);
+		if (rawcmd_send())
+		{
+			return LOW_TRACK_TIMEOUT;
+		}
+		lowpos = MAX_TRACK_SIZE - rawcmd.length; // length returns the bytes not transferred
+		floppy_st0 = rawcmd_read(0);
+		floppy_st1 = rawcmd_read(1);
+		floppy_st2 = rawcmd_read(2);
+		floppy_c   = rawcmd_read(3);
+		floppy_h   = rawcmd_read(4);
+		floppy_r   = rawcmd_read(5);
+		floppy_n   = rawcmd_read(6);
+	}
+
+	if (lowpos < 1) return LOW_EMPTY;
+	return LOW_SUCCESS;
+}
+
+uint8 low_read_id(int side) // next sector ID under the head into floppy_c/h/r/n
+{
+	rawcmd_begin(FD_RAW_INTR | FD_RAW_SPIN, 0, NULL, 0);
+	rawcmd_write((encoding << 6) | 0x0A);
+	rawcmd_write((side << 2) | device);
+	if (rawcmd_send()) return LOW_ID_TIMEOUT;
+	floppy_st0 = rawcmd_read(0);
+	floppy_st1 = rawcmd_read(1);
+	floppy_st2 = rawcmd_read(2);
+	floppy_c   = rawcmd_read(3);
+	floppy_h   = rawcmd_read(4);
+	floppy_r   = rawcmd_read(5);
+	floppy_n   = rawcmd_read(6);
+	if (rawcmd.reply_count < 7 || (floppy_st0 & 0xC0)) return LOW_ID;
+	return LOW_SUCCESS;
+}
+
+#else
+
 extern void __interrupt _far floppy_irq();
 extern volatile uint lowpos;
 extern uint8* lowdata;
@@ -534,6 +878,28 @@ uint8 low_read_track(int track, int side)
 	return LOW_SUCCESS;
 }
 
+uint8 low_read_id(int side) // next sector ID under the head into floppy_c/h/r/n
+{
+	floppy_irq_wait = 1;
+	floppy_write((encoding << 6) | 0x0A);
+	floppy_write((side << 2) | device);
+	if (floppy_irq_wait_timeout())
+	{
+		return LOW_ID_TIMEOUT;
+	}
+	floppy_st0 = floppy_read();
+	floppy_st1 = floppy_read();
+	floppy_st2 = floppy_read();
+	floppy_c   = floppy_read();
+	floppy_h   = floppy_read();
+	floppy_r   = floppy_read();
+	floppy_n   = floppy_read();
+	if (floppy_st0 & 0xC0) return LOW_ID;
+	return LOW_SUCCESS;
+}
+
+#endif
+
 //
 // high level modes
 //
@@ -690,6 +1056,17 @@ int mode_sector()
 
 const char* DATARATE[4] = { "500", "350", "250", "1000" };
 
+int timing_supported()
+{
+#ifdef __linux__
+	// the driver transfers the track by DMA, there is no per-byte IRQ to time
+	fprintf(stderr,"Per-byte timing is not available on Linux.\n");
+	return 0;
+#else
+	return 1;
+#endif
+}
+
 int mode_low_start(const char* name)
 {
 	int invalid;
@@ -751,6 +1128,7 @@ int mode_low_finish()
 	int c,h;
 	int invalid;
 	uint8 result;
+	uint8 open_result = LOW_SUCCESS;
 	uint32 bytes_read = 0;
 
 	open_output();
@@ -761,28 +1139,30 @@ int mode_low_finish()
 	{
 		printf("%02d:%02d\r",c,h);
 		fflush(stdout);
-		result = low_open();
+		if (LOW_REOPEN || (c == 0 && h == 0)) open_result = low_open();
+		result = open_result;
 		if (!result) result = low_read_track(c,h);
 		if (result)
 		{
 			++invalid;
 			fprintf(stderr,"%02d:%02d error: %s\n",c,h,low_error(result));
 		}
-		low_close();
 		// not certain why I need to close/open for each track read,
 		// but it might get interrupted by the file write?
+		if (LOW_REOPEN) low_close();
 		fputc(c,f); // track
 		fputc(h,f); // side
 		mode_low_track_write();
 		bytes_read += lowpos;
 	}
+	if (!LOW_REOPEN) low_close();
 
 	if (invalid)
 	{
 		printf("Completed, with errors.\n");
 			return RESULT_PARTIAL;
 	}
-	printf("Completed (%ld bytes read).\n", bytes_read);
+	printf("Completed (%ld bytes read).\n", (long)bytes_read);
 	return RESULT_SUCCESS;
 }
 
@@ -804,6 +1184,7 @@ int mode_full()
 	uint8 result;
 	result = mode_low_start("Low");
 	if (result != RESULT_SUCCESS) return result;
+	if (!timing_supported()) return RESULT_TODO;
 
 	// allocate memory and open output
 	lowtime = get_memory(MAX_TRACK_SIZE*2);
@@ -873,7 +1254,7 @@ int mode_track_finish()
 		printf("Completed, with errors.\n");
 			return RESULT_PARTIAL;
 	}
-	printf("Completed (%ld bytes read).\n", bytes_read);
+	printf("Completed (%ld bytes read).\n", (long)bytes_read);
 	return RESULT_SUCCESS;
 }
 
@@ -895,6 +1276,7 @@ int mode_ftrack()
 	uint8 result;
 	result = mode_track_start("Ftrack");
 	if (result != RESULT_SUCCESS) return result;
+	if (!timing_supported()) return RESULT_TODO;
 
 	// allocate memory and open output
 	lowtime = get_memory(MAX_TRACK_SIZE*2);
@@ -904,6 +1286,751 @@ int mode_ftrack()
 	return mode_track_finish();
 }
 
+//
+// serial link
+//
+// The sender (-m send) reads each track and sends the capture over a serial port
+// to a receiver (-m recv) on a faster machine, which decodes the sectors and checks
+// their CRCs, then replies naming any sectors that should be re-read while the
+// sender is still at that track.
+//
+// Every packet is a type byte, a payload, and a 16-bit CRC of both (little-endian).
+// Sender packets, each answered by one reply:
+//   G tracks, sides, sectors, bytes (16-bit)    Geometry, always sent first.
+//   T track, side, length (32-bit), data        Track capture, as -m low.
+//   S track, side, count, count * (sector, BIOS result, data)   Re-read sectors.
+//   E                                           End of disk.
+// Receiver replies:
+//   K                      Continue.
+//   R count, count * sector   Re-read these sectors, answer with S.
+//   N                      Packet was corrupt, send it again.
+// Resending a packet is harmless, so a corrupt reply is treated as N,
+// and a lost reply is recovered by resending after LINK_TIMEOUT.
+// If its UART has a FIFO, the sender reads the next side of a cylinder before
+// collecting the reply to the previous one, but finishes every side of a cylinder
+// before seeking on. A reply to T names at most LINK_REREAD_FIFO sectors to fit.
+//
+
+enum {
+	LINK_GEOMETRY = 'G',
+	LINK_TRACK    = 'T',
+	LINK_SECTORS  = 'S',
+	LINK_END      = 'E',
+	LINK_OK       = 'K',
+	LINK_REREAD   = 'R',
+	LINK_RESEND   = 'N',
+	LINK_CORRUPT  = -1,
+	LINK_NOISE    = -2,
+	LINK_QUIET    = -3,
+};
+
+const char* const LINK_PACKETS = "GTSE"; // sent by the sender
+const char* const LINK_REPLIES = "KRN"; // sent by the receiver
+
+uint16 crc16(uint16 crc, uint8 value) // CRC-16-CCITT, as used by the FDC
+{
+	int i;
+	crc ^= value << 8;
+	for (i=0; i<8; ++i)
+	{
+		crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+	}
+	return crc;
+}
+
+#ifdef __linux__
+
+int link_open() // returns 0 on success
+{
+	struct termios t;
+	linkfd = open(linkname, O_RDWR | O_NOCTTY);
+	if (linkfd < 0) return -1;
+	if (tcgetattr(linkfd, &t) == 0) // raw 8N1 115200
+	{
+		cfmakeraw(&t);
+		cfsetispeed(&t, B115200);
+		cfsetospeed(&t, B115200);
+		t.c_cflag |= CLOCAL | CREAD;
+		tcsetattr(linkfd, TCSANOW, &t);
+	}
+	return 0;
+}
+
+void link_close()
+{
+	if (linkfd >= 0) close(linkfd);
+	linkfd = -1;
+}
+
+int link_write(const uint8* data, uint32 length)
+{
+	uint32 i;
+	long w;
+	for (i=0; i<length; ++i) link_crc = crc16(link_crc, data[i]);
+	while (length > 0)
+	{
+		w = write(linkfd, data, length);
+		if (w < 0)
+		{
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		data += w;
+		length -= w;
+	}
+	return 0;
+}
+
+int link_read(uint8* data, uint32 length, uint ticks) // ticks 0 waits forever
+{
+	struct pollfd p;
+	long r;
+	uint32 i;
+	while (length > 0)
+	{
+		p.fd = linkfd;
+		p.events = POLLIN;
+		r = poll(&p, 1, ticks ? (int)(ticks * 55) : -1);
+		if (r < 0 && errno == EINTR) continue;
+		if (r <= 0) return -1;
+		r = read(linkfd, data, length);
+		if (r < 0 && errno == EINTR) continue;
+		if (r <= 0) return -1;
+		for (i=0; i<(uint32)r; ++i) link_crc = crc16(link_crc, data[i]);
+		data += r;
+		length -= r;
+	}
+	return 0;
+}
+
+#else
+
+typedef struct { const char* const name; uint port; } LinkPort;
+const LinkPort LINK_PORT[] = {
+	{ "COM1", 0x3F8 },
+	{ "COM2", 0x2F8 },
+	{ "COM3", 0x3E8 },
+	{ "COM4", 0x2E8 },
+};
+
+int link_open() // returns 0 on success
+{
+	int i;
+	for (i=0; i < (sizeof(LINK_PORT)/sizeof(LINK_PORT[0])); ++i)
+	{
+		if (!stricmp(LINK_PORT[i].name, linkname)) linkport = LINK_PORT[i].port;
+	}
+	if (linkport == 0) return -1;
+	outp(linkport|1, 0x00); // no UART interrupts
+	outp(linkport|3, 0x80); // divisor latch
+	outp(linkport|0, 0x01); // 115200 baud
+	outp(linkport|1, 0x00);
+	outp(linkport|3, 0x03); // 8N1
+	outp(linkport|2, 0xC7); // clear and enable FIFO
+	linkfifo = ((inp(linkport|2) & 0xC0) == 0xC0); // only a 16550A reports a working FIFO
+	outp(linkport|4, 0x03); // DTR, RTS
+	return 0;
+}
+
+void link_close()
+{
+	linkport = 0;
+}
+
+int link_put(uint8 value)
+{
+	uint16 timeout = 0;
+	do
+	{
+		if (inp(linkport|5) & 0x20) // transmit holding register empty
+		{
+			outp(linkport|0, value);
+			return 0;
+		}
+		++timeout;
+	} while (timeout);
+	return -1;
+}
+
+int link_write(const uint8* data, uint32 length)
+{
+	for (; length > 0; --length, ++data)
+	{
+		if (link_put(*data)) return -1;
+		link_crc = crc16(link_crc, *data);
+	}
+	return 0;
+}
+
+int link_read(uint8* data, uint32 length, uint ticks) // ticks 0 waits forever
+{
+	uint16 short_timeout;
+	long timestart;
+	long timenow;
+	int ready;
+	for (; length > 0; --length, ++data)
+	{
+		timestart = 0;
+		ready = 0;
+		while (!ready)
+		{
+			// check for data 65536 times
+			short_timeout = 0;
+			do
+			{
+				if (inp(linkport|5) & 0x01) { ready = 1; break; } // data ready
+				++short_timeout;
+			} while (short_timeout);
+			// check the system clock for timeout
+			if (ready || ticks == 0) continue;
+			if (timestart == 0) _bios_timeofday(_TIME_GETCLOCK,&timestart);
+			else
+			{
+				_bios_timeofday(_TIME_GETCLOCK,&timenow);
+				timenow -= timestart;
+				if (timenow >= ticks) return -1;
+			}
+		}
+		*data = inp(linkport|0);
+		link_crc = crc16(link_crc, *data);
+	}
+	return 0;
+}
+
+#endif
+
+void open_link() // exits if port could not be opened
+{
+	if (link_open())
+	{
+		fprintf(stderr,"Unable to open serial port: %s\n",linkname);
+		exit(RESULT_LINK);
+	}
+	printf("Opened serial port: %s\n",linkname);
+}
+
+void link_drain() // discard input until the line is quiet
+{
+	uint8 b;
+	while (!link_read(&b,1,9));
+}
+
+int link_begin(uint8 type)
+{
+	link_crc = 0xFFFF;
+	return link_write(&type,1);
+}
+
+int link_finish()
+{
+	uint8 crc[2];
+	crc[0] = link_crc & 0xFF;
+	crc[1] = link_crc >> 8;
+	return link_write(crc,2);
+}
+
+int link_receive(uint ticks, const char* accept)
+{
+	// Reads a packet of one of the accepted types, returns its type,
+	// LINK_CORRUPT, LINK_NOISE for a byte that doesn't start an accepted packet,
+	// or LINK_QUIET if nothing arrived. Nothing is stored until the CRC matches.
+	uint8 type;
+	uint8 head[6];
+	uint8 ending[2];
+	uint8 list[256];
+	uint head_size;
+	uint32 length = 0;
+	uint16 crc;
+
+	link_crc = 0xFFFF;
+	if (link_read(&type,1,ticks)) return LINK_QUIET;
+	if (type == 0 || strchr(accept,type) == NULL) return LINK_NOISE;
+	switch (type)
+	{
+	case LINK_GEOMETRY: head_size = 5; break;
+	case LINK_TRACK:    head_size = 6; break;
+	case LINK_SECTORS:  head_size = 3; break;
+	case LINK_REREAD:   head_size = 1; break;
+	default:            head_size = 0; break;
+	}
+	if (link_read(head,head_size,LINK_TIMEOUT)) return LINK_CORRUPT;
+
+	if (type == LINK_TRACK)
+	{
+		length = (uint32)head[2] | ((uint32)head[3] << 8) | ((uint32)head[4] << 16) | ((uint32)head[5] << 24);
+		if (length > MAX_TRACK_SIZE) return LINK_CORRUPT;
+		if (link_read(linkdata,length,LINK_TIMEOUT)) return LINK_CORRUPT;
+	}
+	else if (type == LINK_SECTORS)
+	{
+		length = (uint32)head[2] * (2 + sector_bytes);
+		if (sector_bytes < 0 || length > MAX_TRACK_SIZE) return LINK_CORRUPT;
+		if (link_read(linkdata,length,LINK_TIMEOUT)) return LINK_CORRUPT;
+	}
+	else if (type == LINK_REREAD)
+	{
+		if (link_read(list,head[0],LINK_TIMEOUT)) return LINK_CORRUPT;
+	}
+
+	crc = link_crc;
+	if (link_read(ending,2,LINK_TIMEOUT)) return LINK_CORRUPT;
+	if (crc != (ending[0] | (ending[1] << 8))) return LINK_CORRUPT;
+
+	if (type == LINK_GEOMETRY)
+	{
+		tracks        = head[0];
+		sides         = head[1];
+		track_sectors = head[2];
+		sector_bytes  = head[3] | (head[4] << 8);
+	}
+	else if (type == LINK_TRACK)
+	{
+		link_c = head[0];
+		link_h = head[1];
+		memcpy(lowdata, linkdata, length);
+		lowpos = length;
+	}
+	else if (type == LINK_SECTORS) // sector data is left in linkdata
+	{
+		link_c = head[0];
+		link_h = head[1];
+		link_count = head[2];
+	}
+	else if (type == LINK_REREAD)
+	{
+		link_count = head[0];
+		memcpy(linkreread, list, link_count);
+	}
+	return type;
+}
+
+//
+// link sender
+//
+
+int link_send(uint8 type, int c, int h) // send a packet, returns 0 on success
+{
+	uint8 head[6];
+	uint8 result;
+	int i;
+
+	if (link_begin(type)) return -1;
+	if (type == LINK_GEOMETRY)
+	{
+		head[0] = tracks;
+		head[1] = sides;
+		head[2] = track_sectors;
+		head[3] = sector_bytes & 0xFF;
+		head[4] = sector_bytes >> 8;
+		if (link_write(head,5)) return -1;
+	}
+	else if (type == LINK_TRACK)
+	{
+		head[0] = c;
+		head[1] = h;
+		head[2] = (lowpos >>  0) & 0xFF;
+		head[3] = (lowpos >>  8) & 0xFF;
+		head[4] = ((uint32)lowpos >> 16) & 0xFF;
+		head[5] = ((uint32)lowpos >> 24) & 0xFF;
+		if (link_write(head,6)) return -1;
+		if (link_write(lowdata,lowpos)) return -1;
+	}
+	else if (type == LINK_SECTORS)
+	{
+		head[0] = c;
+		head[1] = h;
+		head[2] = link_count;
+		if (link_write(head,3)) return -1;
+		for (i=0; i<link_count; ++i)
+		{
+			printf("%02d:%02d:%02d\r",c,h,linkreread[i]);
+			fflush(stdout);
+			result = high_read_sector(c,h,linkreread[i]);
+			head[0] = linkreread[i];
+			head[1] = result;
+			if (link_write(head,2)) return -1;
+			if (link_write(highdata,sector_bytes)) return -1;
+		}
+	}
+	return link_finish();
+}
+
+int link_verdict(uint8 type, int c, int h) // reply to a packet already sent, resending it as needed, -1 on failure
+{
+	int i;
+	int reply;
+	for (i=0; i<LINK_RETRIES; ++i)
+	{
+		if (i > 0 && link_send(type,c,h)) return -1;
+		do
+		{
+			reply = link_receive(LINK_TIMEOUT,LINK_REPLIES);
+		} while (reply == LINK_NOISE);
+		if (reply == LINK_OK || reply == LINK_REREAD) return reply;
+		link_drain();
+	}
+	return -1;
+}
+
+int link_exchange(uint8 type, int c, int h) // send a packet and return the reply type, -1 on failure
+{
+	if (link_send(type,c,h)) return -1;
+	return link_verdict(type,c,h);
+}
+
+int link_track_finish(int c, int h) // wait for the verdict on a sent track, and re-read sectors it names
+{
+	int reply;
+	lowdata = linkcapture + (h * MAX_TRACK_SIZE); // in case it must be resent
+	lowpos = linkcapture_pos[h];
+	reply = link_verdict(LINK_TRACK,c,h);
+	if (reply == LINK_REREAD && LOW_REOPEN) high_reset(); // BIOS needs the FDC back after low_close
+	while (reply == LINK_REREAD)
+	{
+		reply = link_exchange(LINK_SECTORS,c,h);
+	}
+	if (reply < 0)
+	{
+		fprintf(stderr,"%02d:%02d link failure.\n",c,h);
+		return -1;
+	}
+	return 0;
+}
+
+int mode_send_tracks()
+{
+	int c,h;
+	int invalid;
+	uint8 result;
+	uint8 open_result = LOW_SUCCESS;
+	uint32 bytes_read = 0;
+
+	result = mode_low_start("Send");
+	if (result != RESULT_SUCCESS) return result;
+
+	// the receiver needs sector geometry to decode tracks
+	if (sector_bytes < 0) sector_bytes = boot_sector_bytes;
+	if (sector_bytes < 0) sector_bytes = 512; // default
+	printf("Sectors: ");
+	printparam(track_sectors);
+	printf(" sectors, ");
+	printparam(sector_bytes);
+	printf(" bytes\n");
+
+	invalid = 0;
+	if (track_sectors < 1) { fprintf(stderr,"Sectors per track unspecified.\n"); invalid=1; }
+	if (sector_bytes > MAX_SECTOR_SIZE) { fprintf(stderr,"Sector size too large. Maximum: %d\n",MAX_SECTOR_SIZE); invalid=1; }
+	if (invalid) return RESULT_FATAL; // fatal error
+
+	// one capture for each side of a cylinder (2 * 31000 still fits in a DOS segment)
+	linkcapture = get_memory((size_t)MAX_TRACK_SIZE * 2);
+	lowtime_on = 0;
+
+	open_link();
+	if (link_exchange(LINK_GEOMETRY,0,0) != LINK_OK)
+	{
+		fprintf(stderr,"No reply from receiver.\n");
+		return RESULT_LINK;
+	}
+
+	// Each side is sent without waiting, and the verdict on it is collected after
+	// reading the next side of the cylinder, so the receiver decodes while we read.
+	// Any re-reads still happen before leaving the cylinder.
+	// On DOS the verdict waits in the UART's FIFO, so without one each verdict
+	// is collected before reading on.
+	if (!linkfifo) printf("No UART FIFO, reading will wait for the receiver.\n");
+	invalid = 0;
+	for (c=0; c<tracks; ++c)
+	{
+		for (h=0; h<sides; ++h)
+		{
+			printf("%02d:%02d   \r",c,h);
+			fflush(stdout);
+			lowdata = linkcapture + (h * MAX_TRACK_SIZE);
+			if (LOW_REOPEN || (c == 0 && h == 0)) open_result = low_open();
+			result = open_result;
+			if (!result) result = low_read_track(c,h);
+			if (result)
+			{
+				++invalid;
+				fprintf(stderr,"%02d:%02d error: %s\n",c,h,low_error(result));
+			}
+			if (LOW_REOPEN) low_close();
+			linkcapture_pos[h] = lowpos;
+			bytes_read += lowpos;
+
+			if (linkfifo && h > 0 && link_track_finish(c,h-1)) break;
+			lowdata = linkcapture + (h * MAX_TRACK_SIZE);
+			lowpos = linkcapture_pos[h];
+			if (link_send(LINK_TRACK,c,h))
+			{
+				fprintf(stderr,"%02d:%02d link failure.\n",c,h);
+				break;
+			}
+			if (!linkfifo && link_track_finish(c,h)) break;
+		}
+		if (h < sides || (linkfifo && link_track_finish(c,sides-1)))
+		{
+			if (!LOW_REOPEN) low_close();
+			return RESULT_LINK;
+		}
+	}
+	if (!LOW_REOPEN) low_close();
+
+	if (link_exchange(LINK_END,0,0) < 0)
+	{
+		fprintf(stderr,"Link failure at end.\n");
+		return RESULT_LINK;
+	}
+
+	if (invalid)
+	{
+		printf("Completed, with errors.\n");
+		return RESULT_PARTIAL;
+	}
+	printf("Completed (%ld bytes read).\n", (long)bytes_read);
+	return RESULT_SUCCESS;
+}
+
+int mode_send()
+{
+	int result = mode_send_tracks();
+	lowdata = NULL; // pointed into linkcapture
+	return result;
+}
+
+//
+// link receiver
+//
+
+uint8 track_byte(uint32 bit) // 8 bits of the captured track from any bit position
+{
+	uint32 i = bit >> 3;
+	uint16 w;
+	if (i >= lowpos) return 0;
+	w = lowdata[i] << 8;
+	if ((i+1) < lowpos) w |= lowdata[i+1];
+	return (uint8)(w >> (8 - (bit & 7)));
+}
+
+int track_mark(uint32 bit) // address mark following A1 A1 A1 sync, or -1
+{
+	if (track_byte(bit+ 0) != 0xA1) return -1;
+	if (track_byte(bit+ 8) != 0xA1) return -1;
+	if (track_byte(bit+16) != 0xA1) return -1;
+	return track_byte(bit+24);
+}
+
+uint16 track_crc(uint32 bit, uint length) // 0 if bytes from bit end with a valid CRC
+{
+	uint16 crc = 0xFFFF;
+	uint i;
+	for (i=0; i<length; ++i) crc = crc16(crc, track_byte(bit + (i*8)));
+	return crc;
+}
+
+void link_decode(int c, int h)
+{
+	// MFM sync bytes (A1 with a missing clock) read back as ordinary A1s,
+	// but sectors written separately from the format may be at a different bit
+	// alignment than the start of the capture, so every bit position is searched.
+	uint8 seen[256];
+	uint32 end = (uint32)lowpos * 8;
+	uint32 bit;
+	uint32 d;
+	uint16 crc;
+	int r, n, m, i, missing;
+	uint field = 4 + sector_bytes + 2; // sync, mark, data, CRC
+
+	memset(seen, 0, sizeof(seen));
+	for (bit=0; (bit + (10*8)) <= end; ++bit)
+	{
+		// ID: sync, FE, C, H, R, N, CRC
+		if (track_mark(bit) != 0xFE) continue;
+		if (track_crc(bit,10) != 0) continue;
+		r = track_byte(bit+48);
+		n = track_byte(bit+56);
+		if (track_byte(bit+32) != c || track_byte(bit+40) != h) continue;
+		if (r < 1 || r > track_sectors || n > 7 || (128 << n) != sector_bytes) continue;
+		seen[r-1] = 1;
+		// data: sync, FB or F8 (deleted), data, CRC
+		for (d = bit + (10*8); d < bit + (LINK_DATA_SEARCH*8) && (d + (field*8)) <= end; ++d)
+		{
+			m = track_mark(d);
+			if (m != 0xFB && m != 0xF8) continue;
+			if (track_crc(d,field) == 0)
+			{
+				for (i=0; i<sector_bytes; ++i) linkimage[((r-1)*sector_bytes)+i] = track_byte(d + 32 + (i*8));
+				linkgood[r-1] = 1;
+			}
+			break;
+		}
+		bit += (10*8) - 1; // skip the rest of the ID
+	}
+
+	// The read track command starts in the data field of the first sector,
+	// after its ID and mark, so if exactly one sector's ID was not seen it is probably that one.
+	missing = -1;
+	for (r=0; r<track_sectors; ++r)
+	{
+		if (seen[r])  continue;
+		if (missing >= 0) return;
+		missing = r;
+	}
+	if (missing < 0 || linkgood[missing] || lowpos < (uint32)(sector_bytes + 2)) return;
+	for (m=0xF8; m<=0xFB; m+=3) // either data mark
+	{
+		crc = crc16(crc16(crc16(crc16(0xFFFF,0xA1),0xA1),0xA1),m);
+		for (i=0; i<(sector_bytes+2); ++i) crc = crc16(crc, lowdata[i]);
+		if (crc != 0) continue;
+		memcpy(linkimage + (missing*sector_bytes), lowdata, sector_bytes);
+		linkgood[missing] = 1;
+		break;
+	}
+}
+
+void link_merge() // keep sectors re-read without error
+{
+	int i, r;
+	uint8* p = linkdata;
+	for (i=0; i<link_count; ++i, p += (2 + sector_bytes))
+	{
+		r = p[0];
+		if (r < 1 || r > track_sectors || p[1] != 0) continue;
+		memcpy(linkimage + ((r-1)*sector_bytes), p+2, sector_bytes);
+		linkgood[r-1] = 1;
+	}
+}
+
+int link_flush(int c, int h) // write the current track, returns number of missing sectors
+{
+	int r;
+	int invalid = 0;
+	if (c < 0 || linkimage == NULL) return 0;
+	for (r=0; r<track_sectors; ++r)
+	{
+		if (linkgood[r]) continue;
+		++invalid;
+		fprintf(stderr,"%02d:%02d:%02d error: Not recovered\n",c,h,r+1);
+	}
+	fwrite(linkimage,1,track_sectors*sector_bytes,f);
+	return invalid;
+}
+
+int mode_recv()
+{
+	int c = -1; // current track
+	int h = -1;
+	int rounds = 0;
+	int type;
+	int r;
+	int invalid = 0;
+	long image_size = 0;
+	uint8 count;
+
+	lowdata = get_memory(MAX_TRACK_SIZE);
+	linkdata = get_memory(MAX_TRACK_SIZE);
+	lowtime_on = 0;
+
+	open_output();
+	open_link();
+	printf("Waiting for sender...\n");
+
+	do
+	{
+		type = link_receive(LINK_IDLE,LINK_PACKETS);
+		if (type == LINK_NOISE) continue; // noise before a packet
+		if (type == LINK_QUIET)
+		{
+			invalid += link_flush(c,h);
+			fprintf(stderr,"Sender stopped responding.\n");
+			return RESULT_LINK;
+		}
+		if (type == LINK_CORRUPT || (type != LINK_GEOMETRY && linkimage == NULL))
+		{
+			link_drain();
+			link_begin(LINK_RESEND);
+			link_finish();
+			continue;
+		}
+
+		if (type == LINK_GEOMETRY)
+		{
+			printf("Receive: %d tracks, %d sides, %d sectors, %d bytes\n",
+				tracks, sides, track_sectors, sector_bytes);
+			if (track_sectors < 1 || sector_bytes < 128 || sector_bytes > MAX_SECTOR_SIZE ||
+				((long)track_sectors * sector_bytes) > MAX_TRACK_SIZE ||
+				(linkimage != NULL && ((long)track_sectors * sector_bytes) != image_size))
+			{
+				fprintf(stderr,"Invalid geometry from sender.\n");
+				return RESULT_LINK;
+			}
+			image_size = (long)track_sectors * sector_bytes;
+			if (linkimage == NULL) linkimage = get_memory(image_size);
+		}
+		else if (type == LINK_TRACK || type == LINK_SECTORS)
+		{
+			if (link_c != c || link_h != h) // next track
+			{
+				invalid += link_flush(c,h);
+				c = link_c;
+				h = link_h;
+				rounds = 0;
+				memset(linkimage, fill & 0xFF, image_size);
+				memset(linkgood, 0, sizeof(linkgood));
+				printf("%02d:%02d\r",c,h);
+				fflush(stdout);
+			}
+			if (type == LINK_TRACK) link_decode(c,h);
+			else link_merge();
+
+			count = 0;
+			for (r=0; r<track_sectors; ++r)
+			{
+				if (!linkgood[r]) linkreread[count++] = r+1;
+			}
+			// the sender may be reading while this reply waits in its UART,
+			// any further sectors are named in the reply to the re-read
+			if (type == LINK_TRACK && count > LINK_REREAD_FIFO) count = LINK_REREAD_FIFO;
+			if (count > 0 && rounds < LINK_REREADS)
+			{
+				++rounds;
+				link_begin(LINK_REREAD);
+				link_write(&count,1);
+				link_write(linkreread,count);
+				link_finish();
+				continue;
+			}
+		}
+		else if (type == LINK_END)
+		{
+			invalid += link_flush(c,h);
+		}
+		link_begin(LINK_OK);
+		link_finish();
+	} while (type != LINK_END);
+
+	// If our last reply was lost the sender will resend E after its timeout,
+	// so keep answering until the line has been quiet for longer than that.
+	do
+	{
+		type = link_receive(LINK_TIMEOUT + 18,"E");
+		if (type == LINK_END)
+		{
+			link_begin(LINK_OK);
+			link_finish();
+		}
+	} while (type != LINK_QUIET);
+
+	if (invalid)
+	{
+		printf("Completed, with errors.\n");
+		return RESULT_PARTIAL;
+	}
+	printf("Completed.\n");
+	return RESULT_SUCCESS;
+}
+
 //
 // command line parsing and main program
 //
@@ -916,6 +2043,8 @@ enum {
 	MODE_SECTOR,
 	MODE_TRACK,
 	MODE_FTRACK,
+	MODE_SEND,
+	MODE_RECV,
 	MODE_COUNT
 };
 
@@ -927,9 +2056,11 @@ const char* MODE_NAME[MODE_COUNT] = {
 	"SECTOR",
 	"TRACK",
 	"FTRACK",
+	"SEND",
+	"RECV",
 };
 
-const char* ARGS_OPTS = ":b:h:t:s:d:f:r:p:e:o:l:u:m:";
+const char* ARGS_OPTS = ":b:h:t:s:d:f:r:p:e:o:l:u:m:c:";
 
 const char* ARGS_INFO =
 "Modes:\n"
@@ -940,6 +2071,8 @@ const char* ARGS_INFO =
 " -m sector -t 5 -h 0 -s 3 <file>   Read a single sector using BIOS.\n"
 " -m track -t 5 -h 0 <file>         Read a single track.\n"
 " -m ftrack -t 5 -h 0 <file>        Read a single track, timing, fuzzy bits.\n"
+" -m send -c COM1                   Read all tracks, send to a link receiver.\n"
+" -m recv -c /dev/ttyS0 <file>      Receive tracks, decode to a sector image.\n"
 "Options, automatic/default if unspecified:\n"
 " -b 512    Specify bytes per sector, default 512.\n"
 " -h 1      Specify total sides (1,2) default 2, or side (0,1).\n"
@@ -947,6 +2080,7 @@ const char* ARGS_INFO =
 " -s 9      Specify sectors per track, or specific sector.\n"
 " -d 0      Specify device (0,1) = (A:,B:), default 0.\n"
 " -f 0xFF   Use a specific value to fill unreadable space, default 0.\n"
+" -c COM1   Serial port for link modes, 115200 baud.\n"
 "Low level options:\n"
 " -r 1      Data rate (0,1,2,3) = (500 HD,350,250 DD,1000 ED) k/s, default 1.\n"
 " -p 0      Port (0,1) = ($3FX,$37X), default 0.\n"
@@ -1000,7 +2134,7 @@ int main(int argc, char** argv)
 	{
 		do
 		{
-			o = getopt(argc,argv,":b:h:t:s:d:r:p:e:f:m:");
+			o = getopt(argc,argv,":b:h:t:s:d:r:p:e:f:m:c:");
 			if (o == -1) break;
 			switch(o)
 			{
@@ -1016,6 +2150,7 @@ int main(int argc, char** argv)
 				case 'o': intarg(&rate_step,0,15);                   break;
 				case 'l': intarg(&rate_load,0,15);                   break;
 				case 'u': intarg(&rate_unload,0,127);                break;
+				case 'c': linkname = optarg;                         break;
 				case 'm':
 					if (mode != -1)
 					{
@@ -1068,12 +2203,24 @@ int main(int argc, char** argv)
 		fprintf(stderr,"No mode selected. Use -m option.\n");
 		args_error();
 	}
-	if (mode != MODE_BOOT && filename == NULL)
+	if ((mode == MODE_SEND || mode == MODE_RECV) && linkname == NULL)
+	{
+		fprintf(stderr,"No serial port given. Use -c option.\n");
+		args_error();
+	}
+	if (mode != MODE_BOOT && mode != MODE_SEND && filename == NULL)
 	{
 		fprintf(stderr,"No output filename given.\n");
 		args_error();
 	}
 
+	if (mode == MODE_RECV) // host side of the link doesn't use a floppy drive
+	{
+		result = mode_recv();
+		free_all();
+		return result;
+	}
+
 	printf("Resetting BIOS disk system...");
 	result = high_reset();
 	if (result != 0)
@@ -1114,6 +2261,7 @@ int main(int argc, char** argv)
 	case MODE_SECTOR: result = mode_sector(); break;
 	case MODE_TRACK:  result = mode_track();  break;
 	case MODE_FTRACK: result = mode_ftrack(); break;
+	case MODE_SEND:   result = mode_send();   break;
 	default:
 		fprintf(stderr,"Unexpected mode (%d).\n",mode);
 		result = RESULT_MODE;
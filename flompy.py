@@ -0,0 +1,184 @@
+#
+# FLOMPY
+# Dump file reader for Python, using NumPy.
+#
+# https://github.com/bbbradsmith/flompy
+#
+# The dump file is memory mapped, and every array returned is a view
+# into that mapping, so nothing is copied or parsed until it is used.
+#
+# Track dumps (-m low, -m full, -m track, -m ftrack):
+#     import flompy
+#     d = flompy.TrackDump("disk.flw")
+#     for t in d:
+#         if t.time is not None and len(t.time):
+#             print(t.track, t.side, len(t.data), t.time[-1] / flompy.PIT_HZ)
+#
+# Sector dumps (-m high):
+#     s = flompy.SectorDump("disk.img")
+#     boot = s.sector(0,0,1)
+#     for c,h,r,data in s:
+#         ...
+#
+
+import collections
+import os
+import numpy
+
+# largest capture from either version, keep this equal to the Linux MAX_TRACK_SIZE in flompy.c
+MAX_TRACK_SIZE = 65535
+
+# keep equal to MAX_SECTOR_SIZE in flompy.c
+MAX_SECTOR_SIZE = 2048
+
+# timing values count ticks of the PIT timer at this rate
+PIT_HZ = 1193182
+
+# track: cylinder (None for single track dumps)
+# side: head (None for single track dumps)
+# data: uint8 array of bytes read from the track
+# time: uint16 array of timings for each byte, or None if not a timed dump
+Track = collections.namedtuple("Track", ["track", "side", "data", "time"])
+
+
+def _load(filename):
+    # an empty file cannot be memory mapped
+    if os.path.getsize(filename) < 1:
+        return numpy.zeros(0, numpy.uint8)
+    return numpy.memmap(filename, dtype=numpy.uint8, mode="r")
+
+
+class TrackDump:
+    """
+    Low level track dump.
+
+    timing: True for -m full/ftrack dumps, False for -m low/track, None to detect.
+    single: True for -m track/ftrack dumps, False for -m low/full, None to detect.
+    """
+
+    def __init__(self, filename, timing=None, single=None):
+        self.filename = filename
+        self.raw = _load(filename)
+        self._index = None
+        for s in ([single] if single is not None else [False, True]):
+            for t in ([timing] if timing is not None else [True, False]):
+                self._index = self._parse(s, t)
+                if self._index is not None:
+                    self.single = s
+                    self.timing = t
+                    return
+        raise ValueError("Not a valid FLOMPY track dump: %s" % filename)
+
+    def _parse(self, single, timing):
+        # returns a list of (track, side, data offset, length), or None if the file doesn't match
+        raw = self.raw
+        size = len(raw)
+        index = []
+        pos = 0
+        while pos < size:
+            c = h = None
+            if not single:
+                if pos + 2 > size:
+                    return None
+                c = int(raw[pos+0])
+                h = int(raw[pos+1])
+                pos += 2
+            if pos + 4 > size:
+                return None
+            length = int(raw[pos:pos+4].view("<u4")[0])
+            pos += 4
+            if length > MAX_TRACK_SIZE:
+                return None
+            index.append((c, h, pos, length))
+            pos += length * (3 if timing else 1)
+            if single:
+                break
+        if pos != size or len(index) < 1:
+            return None
+        return index
+
+    def __len__(self):
+        return len(self._index)
+
+    def __getitem__(self, i):
+        (c, h, pos, length) = self._index[i]
+        data = self.raw[pos:pos+length]
+        time = None
+        if self.timing:
+            time = self.raw[pos+length:pos+(length*3)].view("<u2")
+        return Track(c, h, data, time)
+
+    def __iter__(self):
+        for i in range(len(self._index)):
+            yield self[i]
+
+    def track(self, c, h):
+        """Returns the first capture of the given track and side, or None."""
+        for i in range(len(self._index)):
+            if self._index[i][0] == c and self._index[i][1] == h:
+                return self[i]
+        return None
+
+
+class SectorDump:
+    """
+    High level sector dump, sectors in C:H:S order.
+
+    Unspecified geometry is taken from the boot sector, like FLOMPY does.
+    """
+
+    def __init__(self, filename, sector_bytes=None, track_sectors=None, sides=None, tracks=None):
+        self.filename = filename
+        self.raw = _load(filename)
+        boot = self.raw[0:0x22]
+        def boot16(pos):
+            return int(boot[pos:pos+2].view("<u2")[0]) if len(boot) >= pos+2 else -1
+        boot_total_sectors = boot16(0x013)
+        if boot_total_sectors == 0:
+            boot_total_sectors = boot16(0x020)
+        # same auto detection as mode_high in flompy.c
+        if sector_bytes is None:
+            sector_bytes = boot16(0x00B)
+            if sector_bytes < 0:
+                sector_bytes = 512
+        if sector_bytes > MAX_SECTOR_SIZE:
+            raise ValueError("Sector size too large. Maximum: %d" % MAX_SECTOR_SIZE)
+        if sector_bytes < 1: # FLOMPY would write an empty file
+            raise ValueError("Sector size unspecified.")
+        if track_sectors is None:
+            track_sectors = boot16(0x018)
+        if track_sectors <= 0:
+            raise ValueError("Sectors per track unspecified.")
+        if sides is None:
+            sides = boot16(0x01A)
+        if tracks is None:
+            if sides <= 0:
+                sides = 1 if (boot_total_sectors > 0 and boot_total_sectors < 1000) else 2
+            tracks = (boot_total_sectors + ((track_sectors * sides) - 1)) // (track_sectors * sides)
+        if sides <= 0 or sides > 2:
+            sides = 2
+        track_bytes = sector_bytes * track_sectors * sides
+        if len(self.raw) != tracks * track_bytes:
+            # the boot sector is only a guess, the file size is what was written
+            tracks = len(self.raw) // track_bytes
+            if len(self.raw) != tracks * track_bytes:
+                raise ValueError("Sector dump is not a whole number of tracks: %s" % filename)
+        self.sector_bytes = sector_bytes
+        self.track_sectors = track_sectors
+        self.sides = sides
+        self.tracks = tracks
+        # [track][side][sector-1][byte]
+        self.sectors = self.raw.reshape(tracks, sides, track_sectors, sector_bytes)
+
+    def __len__(self):
+        return self.tracks * self.sides * self.track_sectors
+
+    def sector(self, c, h, r):
+        """Sector data, sectors begin counting from 1."""
+        return self.sectors[c, h, r-1]
+
+    def __iter__(self):
+        for c in range(self.tracks):
+            for h in range(self.sides):
+                for r in range(1, self.track_sectors+1):
+                    yield (c, h, r, self.sectors[c, h, r-1])
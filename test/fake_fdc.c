@@ -0,0 +1,311 @@
+//
+// FLOMPY tests
+// Fake FDC standing in for the Linux kernel floppy driver.
+//
+// Commands are answered from a script of replies if one is queued,
+// otherwise from a simulated MFM disk.
+// Included by flompy_test.c after flompy.c.
+//
+
+// simulated disk
+#define FAKE_TRACKS    2
+#define FAKE_SIDES     2
+#define FAKE_SECTORS   9
+#define FAKE_N         2 // 512 byte sectors
+#define FAKE_BYTES     (128 << FAKE_N)
+#define FAKE_REVOLUTION   12500 // bytes in one revolution at 500 kb/s
+
+uint16 fake_corrupt[FAKE_TRACKS][FAKE_SIDES]; // sectors with a bad data CRC in track captures (bit r)
+uint16 fake_unreadable[FAKE_TRACKS][FAKE_SIDES]; // sectors that fail read data
+uint16 fake_shifted[FAKE_TRACKS][FAKE_SIDES]; // sectors written at a different bit alignment
+int fake_cyl = 0; // head position
+int fake_id = 0; // next sector ID under the head
+
+// scripted replies
+typedef struct
+{
+	int fail; // ioctl returns -1
+	int reply_count;
+	uint8 reply[7];
+	long residue; // bytes not transferred
+} FakeReply;
+
+#define FAKE_SCRIPT_MAX   64
+FakeReply fake_script[FAKE_SCRIPT_MAX];
+int fake_script_len = 0;
+int fake_script_pos = 0;
+
+// log of commands received
+#define FAKE_LOG_MAX   256
+uint8 fake_log[FAKE_LOG_MAX][FD_RAW_CMD_SIZE];
+int fake_log_flags[FAKE_LOG_MAX];
+int fake_log_len = 0;
+
+struct floppy_drive_params fake_params;
+int fake_params_set = 0;
+int fake_params_errno = 0; // FDSETDRVPRM fails with this
+int fake_resets = 0;
+
+void fake_reset()
+{
+	memset(fake_corrupt, 0, sizeof(fake_corrupt));
+	memset(fake_unreadable, 0, sizeof(fake_unreadable));
+	memset(fake_shifted, 0, sizeof(fake_shifted));
+	memset(&fake_params, 0, sizeof(fake_params));
+	fake_params.srt = 4000;
+	fake_params.hlt = 16;
+	fake_params.hut = 240;
+	fake_cyl = 0;
+	fake_id = 0;
+	fake_script_len = 0;
+	fake_script_pos = 0;
+	fake_log_len = 0;
+	fake_params_set = 0;
+	fake_params_errno = 0;
+	fake_resets = 0;
+}
+
+void fake_queue(int fail, int reply_count, const uint8* reply, long residue)
+{
+	FakeReply* s = &fake_script[fake_script_len++];
+	s->fail = fail;
+	s->reply_count = reply_count;
+	memset(s->reply, 0, sizeof(s->reply));
+	if (reply_count > 0) memcpy(s->reply, reply, reply_count);
+	s->residue = residue;
+}
+
+int fake_log_count(uint8 command) // number of logged commands with this opcode
+{
+	int i;
+	int count = 0;
+	for (i=0; i<fake_log_len; ++i)
+	{
+		if ((fake_log[i][0] & 0x1F) == command) ++count;
+	}
+	return count;
+}
+
+uint8 fake_sector_byte(int c, int h, int r, int i)
+{
+	return (uint8)((c*7) + (h*3) + (r*11) + i);
+}
+
+// bit writer for track captures
+uint8* fake_out;
+uint32 fake_bit;
+uint32 fake_bits;
+uint16 fake_crc;
+
+void fake_put(uint8 v)
+{
+	int i;
+	fake_crc = crc16(fake_crc, v);
+	for (i=7; i>=0; --i, ++fake_bit)
+	{
+		if (fake_bit >= fake_bits) continue;
+		if ((v >> i) & 1) fake_out[fake_bit >> 3] |= 0x80 >> (fake_bit & 7);
+	}
+}
+
+void fake_put_crc(int corrupt)
+{
+	uint16 crc = fake_crc ^ (corrupt ? 0x5555 : 0);
+	fake_put(crc >> 8);
+	fake_put(crc & 0xFF);
+}
+
+void fake_put_run(uint8 v, int count)
+{
+	for (; count > 0; --count) fake_put(v);
+}
+
+long fake_read_track(uint8* out, long length, int c, int h)
+{
+	// The capture starts in the data field of sector 1, as the real FDC does.
+	int r, i, bad;
+	fake_out = out;
+	fake_bit = 0;
+	fake_bits = (uint32)length * 8;
+	memset(out, 0, length);
+	for (r=1; r<=FAKE_SECTORS; ++r)
+	{
+		bad = (fake_corrupt[c][h] >> r) & 1;
+		if (r > 1)
+		{
+			fake_put_run(0x4E, 40);
+			if ((fake_shifted[c][h] >> r) & 1) fake_bit += 3;
+			fake_put_run(0x00, 12);
+			fake_crc = 0xFFFF;
+			fake_put_run(0xA1, 3);
+			fake_put(0xFE);
+			fake_put(c);
+			fake_put(h);
+			fake_put(r);
+			fake_put(FAKE_N);
+			fake_put_crc(0);
+			fake_put_run(0x4E, 22);
+			fake_put_run(0x00, 12);
+			fake_crc = 0xFFFF;
+			fake_put_run(0xA1, 3);
+			fake_put(0xFB);
+		}
+		else
+		{
+			fake_crc = 0xFFFF;
+			fake_crc = crc16(crc16(crc16(crc16(fake_crc,0xA1),0xA1),0xA1),0xFB);
+		}
+		for (i=0; i<FAKE_BYTES; ++i) fake_put(fake_sector_byte(c,h,r,i));
+		fake_put_crc(bad);
+	}
+	while (fake_bit < (FAKE_REVOLUTION * 8)) fake_put(0x4E);
+	fake_bit = (fake_bit + 7) & ~7;
+	if (fake_bit > fake_bits) fake_bit = fake_bits;
+	return fake_bit / 8;
+}
+
+int fake_rawcmd(struct floppy_raw_cmd* raw)
+{
+	uint8 cmd = raw->cmd[0] & 0x1F;
+	int unit = raw->cmd[1] & 3;
+	int h = (raw->cmd[1] >> 2) & 1;
+	int c, r, i;
+	long bytes;
+	uint8* data = raw->data;
+
+	raw->reply_count = 0;
+	if (cmd == 0x07) // recalibrate
+	{
+		fake_cyl = 0;
+		raw->reply_count = 2;
+		raw->reply[0] = 0x20 | unit;
+		raw->reply[1] = fake_cyl;
+	}
+	else if (cmd == 0x0F) // seek
+	{
+		fake_cyl = raw->cmd[2];
+		raw->reply_count = 2;
+		raw->reply[0] = 0x20 | unit | (h << 2);
+		raw->reply[1] = fake_cyl;
+	}
+	else if (cmd == 0x02) // read track
+	{
+		c = fake_cyl;
+		bytes = 0;
+		if (c < FAKE_TRACKS) bytes = fake_read_track(data, raw->length, c, h);
+		raw->length -= bytes;
+		raw->reply_count = 7;
+		raw->reply[0] = 0x40 | unit | (h << 2);
+		raw->reply[1] = 0x20; // the 16k "sector" never has a good CRC
+		raw->reply[3] = c;
+		raw->reply[4] = h;
+		raw->reply[5] = 1;
+		raw->reply[6] = 7;
+	}
+	else if (cmd == 0x06) // read data
+	{
+		if (raw->flags & FD_RAW_NEED_SEEK) fake_cyl = raw->track;
+		c = raw->cmd[2];
+		r = raw->cmd[4];
+		raw->reply_count = 7;
+		raw->reply[0] = unit | (h << 2);
+		raw->reply[3] = c;
+		raw->reply[4] = h;
+		raw->reply[5] = r;
+		raw->reply[6] = raw->cmd[5];
+		if (c != fake_cyl || c >= FAKE_TRACKS || r < 1 || r > FAKE_SECTORS || raw->cmd[5] != FAKE_N)
+		{
+			raw->reply[0] |= 0x40;
+			raw->reply[1] = 0x04; // no data
+		}
+		else if ((fake_unreadable[c][h] >> r) & 1)
+		{
+			raw->reply[0] |= 0x40;
+			raw->reply[1] = 0x20; // data error
+			raw->reply[2] = 0x20;
+		}
+		else
+		{
+			for (i=0; i<FAKE_BYTES && i<raw->length; ++i) data[i] = fake_sector_byte(c,h,r,i);
+			raw->length -= i;
+		}
+	}
+	else if (cmd == 0x0A) // read ID
+	{
+		raw->reply_count = 7;
+		raw->reply[0] = unit | (h << 2);
+		raw->reply[3] = fake_cyl;
+		raw->reply[4] = h;
+		raw->reply[5] = fake_id + 1;
+		raw->reply[6] = FAKE_N;
+		fake_id = (fake_id + 1) % FAKE_SECTORS;
+	}
+	else
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+int fake_ioctl(int fd, unsigned long request, void* arg)
+{
+	struct floppy_raw_cmd* raw = arg;
+	FakeReply* s;
+
+	if (request == FDRESET)
+	{
+		++fake_resets;
+		return 0;
+	}
+	if (request == FDGETDRVPRM)
+	{
+		*(struct floppy_drive_params*)arg = fake_params;
+		return 0;
+	}
+	if (request == FDSETDRVPRM)
+	{
+		if (fake_params_errno)
+		{
+			errno = fake_params_errno;
+			return -1;
+		}
+		fake_params = *(struct floppy_drive_params*)arg;
+		++fake_params_set;
+		return 0;
+	}
+	if (request != FDRAWCMD)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (fake_log_len < FAKE_LOG_MAX)
+	{
+		memcpy(fake_log[fake_log_len], raw->cmd, FD_RAW_CMD_SIZE);
+		fake_log_flags[fake_log_len] = raw->flags;
+		++fake_log_len;
+	}
+
+	if (fake_script_pos < fake_script_len)
+	{
+		s = &fake_script[fake_script_pos++];
+		if (s->fail)
+		{
+			errno = EIO;
+			return -1;
+		}
+		raw->reply_count = s->reply_count;
+		memcpy(raw->reply, s->reply, sizeof(s->reply));
+		if (raw->flags & FD_RAW_READ) raw->length = s->residue;
+		return 0;
+	}
+	return fake_rawcmd(raw);
+}
+
+void fake_install()
+{
+	fake_reset();
+	floppy_ioctl = fake_ioctl;
+	if (fdd < 0) fdd = open("/dev/null", O_RDWR);
+}
@@ -0,0 +1,295 @@
+//
+// FLOMPY tests
+// Linux backend tests, run against a fake FDC.
+//
+//   flompy_test unit          Run the unit tests.
+//   flompy_test run <args>    Run FLOMPY with the fake FDC.
+//                             FAKE_CORRUPT, FAKE_UNREADABLE, FAKE_SHIFTED may list
+//                             sectors as "c:h:r,c:h:r" to damage the simulated disk.
+//                             FAKE_NO_FIFO makes the sender act as without a UART FIFO.
+//
+
+#define main flompy_main
+#include "../flompy.c"
+#undef main
+
+#include "fake_fdc.c"
+
+int failures = 0;
+
+#define CHECK(x) check((x), #x, __LINE__)
+
+void check(int pass, const char* text, int line)
+{
+	if (pass) return;
+	++failures;
+	fprintf(stderr,"FAIL line %d: %s\n", line, text);
+}
+
+void test_low_open()
+{
+	fake_install();
+	datarate = 1;
+	rate_step = 13;
+	rate_load = 15;
+	rate_unload = 1;
+	fake_cyl = 40;
+	CHECK(low_open() == LOW_SUCCESS);
+	CHECK(fake_params_set == 1);
+	// the driver turns these back into the same specify fields at 300 kb/s
+	CHECK(fake_params.srt == 5000);
+	CHECK(fake_params.hut == 400);
+	CHECK(fake_params.hlt == 3);
+	CHECK(fake_log_count(0x07) == 1);
+	CHECK(fake_log_count(0x03) == 0); // no raw specify
+	CHECK(fake_cyl == 0);
+	low_close();
+	CHECK(fake_params.srt == 4000);
+	CHECK(fake_params.hut == 240);
+	CHECK(fake_params.hlt == 16);
+
+	// calibration that never reaches track 0
+	fake_install();
+	{
+		uint8 r[2] = { 0x20, 5 };
+		int i;
+		for (i=0; i<SEEK_RETRIES; ++i) fake_queue(0,2,r,0);
+	}
+	CHECK(low_open() == LOW_CALIBRATE);
+	CHECK(fake_log_count(0x07) == SEEK_RETRIES);
+	CHECK(fake_params.srt == 4000); // restored without low_close
+	CHECK(drive_params_set == 0);
+
+	fake_install();
+	fake_queue(1,0,NULL,0);
+	CHECK(low_open() == LOW_CALIBRATE_TIMEOUT);
+	CHECK(fake_params.hut == 240);
+	CHECK(drive_params_set == 0);
+
+	// without root the driver's timings are kept
+	fake_install();
+	fake_params_errno = EPERM;
+	CHECK(low_open() == LOW_SUCCESS);
+	CHECK(fake_params_set == 0);
+	CHECK(fake_log_count(0x07) == 1);
+	low_close();
+
+	fake_install();
+	fake_params_errno = EIO;
+	CHECK(low_open() == LOW_RESET);
+	CHECK(fake_log_count(0x07) == 0);
+}
+
+void test_low_read_track()
+{
+	uint8* expect;
+	long length;
+
+	fake_install();
+	lowdata = get_memory(MAX_TRACK_SIZE);
+	expect = get_memory(MAX_TRACK_SIZE);
+	CHECK(low_open() == LOW_SUCCESS);
+	CHECK(low_read_track(1,1) == LOW_SUCCESS);
+	CHECK(fake_cyl == 1);
+	CHECK(floppy_c == 1);
+	length = fake_read_track(expect, MAX_TRACK_SIZE, 1, 1);
+	CHECK(lowpos == length);
+	CHECK(memcmp(lowdata, expect, length) == 0);
+	CHECK(fake_log[fake_log_len-1][0] == 0x42);
+	CHECK(fake_log[fake_log_len-1][1] == 0x04);
+	CHECK(fake_log[fake_log_len-1][5] == 0x07);
+	CHECK(fake_log_flags[fake_log_len-1] & FD_RAW_READ);
+	CHECK(fake_log_flags[fake_log_len-1] & FD_RAW_SPIN);
+	low_close();
+	free(expect);
+
+	// seek that never arrives
+	fake_install();
+	{
+		uint8 r[2] = { 0x20, 3 };
+		int i;
+		for (i=0; i<SEEK_RETRIES; ++i) fake_queue(0,2,r,0);
+	}
+	CHECK(low_read_track(1,0) == LOW_SEEK);
+	CHECK(fake_log_count(0x0F) == SEEK_RETRIES);
+
+	fake_install();
+	fake_queue(1,0,NULL,0);
+	CHECK(low_read_track(1,0) == LOW_SEEK_TIMEOUT);
+
+	// read track that returns nothing is retried
+	fake_install();
+	{
+		uint8 seek[2] = { 0x20, 1 };
+		uint8 r[7] = { 0x40, 0x01, 0x00, 1, 0, 1, 7 };
+		int i;
+		fake_queue(0,2,seek,0);
+		for (i=0; i<READ_RETRIES; ++i) fake_queue(0,7,r,MAX_TRACK_SIZE);
+	}
+	CHECK(low_read_track(1,0) == LOW_EMPTY);
+	CHECK(fake_log_count(0x02) == READ_RETRIES);
+	CHECK(floppy_st1 == 0x01);
+
+	fake_install();
+	{
+		uint8 seek[2] = { 0x20, 1 };
+		fake_queue(0,2,seek,0);
+		fake_queue(1,0,NULL,0);
+	}
+	CHECK(low_read_track(1,0) == LOW_TRACK_TIMEOUT);
+
+	free(lowdata); lowdata = NULL;
+}
+
+void test_high_read_sector()
+{
+	int i;
+	int match;
+
+	fake_install();
+	sector_bytes = 512;
+	CHECK(high_read_sector(1,0,4) == 0x00);
+	match = 1;
+	for (i=0; i<512; ++i) if (highdata[i] != fake_sector_byte(1,0,4,i)) match = 0;
+	CHECK(match);
+	CHECK(fake_log[0][0] == 0x46);
+	CHECK(fake_log[0][2] == 1);
+	CHECK(fake_log[0][4] == 4);
+	CHECK(fake_log[0][5] == 2);
+	CHECK(fake_log[0][6] == 4);
+	CHECK(fake_log_flags[0] & FD_RAW_NEED_SEEK);
+	CHECK(fake_log_flags[0] & FD_RAW_SPIN);
+
+	// errors are retried and reported as BIOS codes
+	fake_install();
+	fake_unreadable[1][0] = 1 << 4;
+	CHECK(high_read_sector(1,0,4) == 0x10);
+	CHECK(fake_log_count(0x06) == HIGH_RETRIES);
+	CHECK(highdata[0] == (fill & 0xFF));
+
+	fake_install();
+	CHECK(high_read_sector(1,0,12) == 0x04);
+
+	fake_install();
+	{
+		uint8 r[7] = { 0x40, 0x01, 0x00, 0, 0, 1, 2 };
+		fake_queue(0,7,r,512);
+	}
+	CHECK(high_read_sector(0,0,1) == 0x00); // missing address mark, then success on retry
+	CHECK(fake_log_count(0x06) == 2);
+
+	fake_install();
+	for (i=0; i<HIGH_RETRIES; ++i) fake_queue(1,0,NULL,0);
+	CHECK(high_read_sector(0,0,1) == 0x80);
+}
+
+void test_low_read_id()
+{
+	fake_install();
+	lowdata = get_memory(MAX_TRACK_SIZE);
+	CHECK(low_read_track(1,1) == LOW_SUCCESS);
+	free(lowdata); lowdata = NULL;
+	CHECK(low_read_id(1) == LOW_SUCCESS);
+	CHECK(floppy_c == 1);
+	CHECK(floppy_h == 1);
+	CHECK(floppy_r == 1);
+	CHECK(floppy_n == FAKE_N);
+	CHECK(low_read_id(1) == LOW_SUCCESS);
+	CHECK(floppy_r == 2);
+	CHECK(fake_log[fake_log_len-1][0] == 0x4A);
+	CHECK(fake_log[fake_log_len-1][1] == 0x04);
+
+	fake_install();
+	{
+		uint8 r[7] = { 0x40, 0x01, 0x00, 0, 0, 0, 0 };
+		fake_queue(0,7,r,0);
+	}
+	CHECK(low_read_id(0) == LOW_ID);
+
+	fake_install();
+	fake_queue(1,0,NULL,0);
+	CHECK(low_read_id(0) == LOW_ID_TIMEOUT);
+}
+
+void test_link_decode()
+{
+	int r, i;
+	int match;
+
+	fake_install();
+	track_sectors = FAKE_SECTORS;
+	sector_bytes = FAKE_BYTES;
+	lowdata = get_memory(MAX_TRACK_SIZE);
+	linkimage = get_memory(FAKE_SECTORS * FAKE_BYTES);
+	fake_corrupt[1][0] = 1 << 3;
+	fake_shifted[1][0] = 1 << 5;
+	lowpos = fake_read_track(lowdata, MAX_TRACK_SIZE, 1, 0);
+	memset(linkgood, 0, sizeof(linkgood));
+	memset(linkimage, 0, FAKE_SECTORS * FAKE_BYTES);
+	link_decode(1,0);
+	for (r=1; r<=FAKE_SECTORS; ++r)
+	{
+		CHECK(linkgood[r-1] == (r != 3));
+		if (!linkgood[r-1]) continue;
+		match = 1;
+		for (i=0; i<FAKE_BYTES; ++i)
+		{
+			if (linkimage[((r-1)*FAKE_BYTES)+i] != fake_sector_byte(1,0,r,i)) match = 0;
+		}
+		CHECK(match);
+	}
+
+	// a capture of the wrong track yields nothing
+	memset(linkgood, 0, sizeof(linkgood));
+	link_decode(0,0);
+	for (r=1; r<FAKE_SECTORS; ++r) CHECK(linkgood[r] == 0);
+
+	free(lowdata); lowdata = NULL;
+	free(linkimage); linkimage = NULL;
+}
+
+void fake_damage(const char* name, uint16 mask[FAKE_TRACKS][FAKE_SIDES])
+{
+	const char* list = getenv(name);
+	int c, h, r, n;
+	while (list != NULL && sscanf(list, "%d:%d:%d%n", &c, &h, &r, &n) == 3)
+	{
+		if (c >= 0 && c < FAKE_TRACKS && h >= 0 && h < FAKE_SIDES) mask[c][h] |= 1 << r;
+		list += n;
+		if (*list != ',') break;
+		++list;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc >= 2 && !strcmp(argv[1],"run"))
+	{
+		fake_install();
+		fake_damage("FAKE_CORRUPT", fake_corrupt);
+		fake_damage("FAKE_UNREADABLE", fake_unreadable);
+		fake_damage("FAKE_SHIFTED", fake_shifted);
+		if (getenv("FAKE_NO_FIFO")) linkfifo = 0;
+		argv[1] = argv[0];
+		return flompy_main(argc-1, argv+1);
+	}
+	if (argc != 2 || strcmp(argv[1],"unit"))
+	{
+		fprintf(stderr,"Usage: flompy_test unit | run <flompy arguments>\n");
+		return 1;
+	}
+
+	test_low_open();
+	test_low_read_track();
+	test_high_read_sector();
+	test_low_read_id();
+	test_link_decode();
+
+	if (failures)
+	{
+		fprintf(stderr,"%d failures.\n", failures);
+		return 1;
+	}
+	printf("All tests passed.\n");
+	return 0;
+}
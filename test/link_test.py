@@ -0,0 +1,283 @@
+#
+# FLOMPY tests
+# Serial link tests over Linux pseudo-terminal pairs.
+#
+# Runs -m send and -m recv through flompy_test, with the fake FDC in place of a
+# floppy drive, against a scripted peer or each other.
+#
+
+import os
+import pty
+import select
+import struct
+import subprocess
+import sys
+import threading
+import time
+import tty
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+FLOMPY = [os.path.join(HERE, "flompy_test"), "run"]
+GEOMETRY = ["-t", "2", "-h", "2", "-s", "9", "-b", "512"]
+TRACKS, SIDES, SECTORS, BYTES = 2, 2, 9, 512
+LINK_TIMEOUT = 10 * 18 / 18.2 # seconds
+
+failures = 0
+
+
+def check(ok, text):
+    global failures
+    if not ok:
+        failures += 1
+        print("FAIL: " + text)
+
+
+def crc16(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def packet(payload):
+    return payload + struct.pack("<H", crc16(payload))
+
+
+def sector(c, h, r):
+    # keep equal to fake_sector_byte in fake_fdc.c
+    return bytes(((c*7) + (h*3) + (r*11) + i) & 0xFF for i in range(BYTES))
+
+
+def open_pty():
+    master, slave = pty.openpty()
+    tty.setraw(master)
+    return master, os.ttyname(slave)
+
+
+class Peer:
+    """Scripted end of the link, speaking through a pty master."""
+
+    def __init__(self, fd):
+        self.fd = fd
+        self.buf = b""
+
+    def fill(self, timeout):
+        r, _, _ = select.select([self.fd], [], [], timeout)
+        if not r:
+            return False
+        self.buf += os.read(self.fd, 65536)
+        return True
+
+    def take(self, n, timeout):
+        end = time.time() + timeout
+        while len(self.buf) < n:
+            if not self.fill(max(0, end - time.time())):
+                return None
+        b, self.buf = self.buf[:n], self.buf[n:]
+        return b
+
+    def packet(self, timeout=LINK_TIMEOUT + 5):
+        # sender packets: returns (type, payload) after checking the CRC
+        t = self.take(1, timeout)
+        if t is None:
+            return None
+        if t == b"G":
+            body = self.take(5, 5)
+        elif t == b"T":
+            head = self.take(6, 5)
+            body = head + self.take(struct.unpack("<I", head[2:6])[0], 5)
+        elif t == b"S":
+            head = self.take(3, 5)
+            body = head + self.take(head[2] * (2 + BYTES), 10)
+        elif t == b"E":
+            body = b""
+        elif t in (b"K", b"N"):
+            body = b""
+        elif t == b"R":
+            head = self.take(1, 5)
+            body = head + self.take(head[0], 5)
+        else:
+            raise Exception("unexpected byte %r" % t)
+        crc = self.take(2, 5)
+        check(crc16(t + body) == struct.unpack("<H", crc)[0], "packet CRC")
+        return (t, body)
+
+    def send(self, data):
+        os.write(self.fd, data)
+
+
+def test_sender():
+    # scripted receiver against the real sender
+    master, name = open_pty()
+    peer = Peer(master)
+    env = dict(os.environ, FAKE_CORRUPT="0:1:3,0:1:7", FAKE_UNREADABLE="0:1:7")
+    p = subprocess.Popen(FLOMPY + ["-m", "send", "-c", name] + GEOMETRY,
+        env=env, stdout=subprocess.DEVNULL)
+
+    t, body = peer.packet()
+    check(t == b"G" and body == bytes([2, 2, 9]) + struct.pack("<H", 512), "geometry")
+    peer.send(packet(b"K"))
+
+    # corrupt reply is answered by resending the track
+    t, body = peer.packet()
+    check(t == b"T" and body[0:2] == bytes([0, 0]), "track 0:0")
+    peer.send(b"K\x00\x00")
+    t, body2 = peer.packet()
+    check(t == b"T" and body2 == body, "track 0:0 resent after corrupt reply")
+    peer.send(b"noise" + packet(b"K"))
+
+    # re-read request, sector 7 stays unreadable
+    t, body = peer.packet()
+    check(t == b"T" and body[0:2] == bytes([0, 1]), "track 0:1")
+    peer.send(packet(b"R" + bytes([2, 3, 7])))
+    t, body = peer.packet()
+    check(t == b"S" and body[0:3] == bytes([0, 1, 2]), "re-read 0:1")
+    s3 = body[3:3+2+BYTES]
+    s7 = body[3+2+BYTES:]
+    check(s3[0:2] == bytes([3, 0]) and s3[2:] == sector(0, 1, 3), "sector 3 re-read")
+    check(s7[0] == 7 and s7[1] != 0, "sector 7 error")
+    peer.send(packet(b"R" + bytes([1, 7])))
+    t, body = peer.packet()
+    check(t == b"S" and body[0:4] == bytes([0, 1, 1, 7]), "second re-read names only sector 7")
+    peer.send(packet(b"K"))
+
+    # re-read request with a corrupt count must not be acted on
+    t, body = peer.packet()
+    check(t == b"T" and body[0:2] == bytes([1, 0]), "track 1:0")
+    bad = bytearray(packet(b"R" + bytes([200]) + bytes(range(1, 201))))
+    bad[-1] ^= 0xFF
+    peer.send(bytes(bad))
+    t, body = peer.packet()
+    check(t == b"T" and body[0:2] == bytes([1, 0]), "track 1:0 resent after corrupt re-read request")
+    peer.send(packet(b"R" + bytes([1, 2])))
+    t, body = peer.packet()
+    check(t == b"S" and body[0:4] == bytes([1, 0, 1, 2]), "re-read after corrupt request names sector 2")
+    peer.send(packet(b"K"))
+
+    t, body = peer.packet()
+    check(t == b"T" and body[0:2] == bytes([1, 1]), "track 1:1")
+    peer.send(packet(b"K"))
+
+    # lost reply to the end packet
+    t, body = peer.packet()
+    check(t == b"E", "end")
+    t, body = peer.packet()
+    check(t == b"E", "end resent after lost reply")
+    peer.send(packet(b"K"))
+
+    check(p.wait(timeout=30) == 0, "sender result")
+    os.close(master)
+
+
+def test_sender_fifo(fifo):
+    # with a FIFO the next side is read before the reply to the last is collected
+    master, name = open_pty()
+    peer = Peer(master)
+    env = dict(os.environ)
+    if not fifo:
+        env["FAKE_NO_FIFO"] = "1"
+    p = subprocess.Popen(FLOMPY + ["-m", "send", "-c", name] + GEOMETRY,
+        env=env, stdout=subprocess.PIPE)
+    out = Peer(p.stdout.fileno())
+    t, body = peer.packet()
+    peer.send(packet(b"K"))
+    t, body = peer.packet()
+    check(t == b"T" and body[0:2] == bytes([0, 0]), "track 0:0")
+    time.sleep(1)
+    while out.fill(0):
+        pass
+    check((b"00:01" in out.buf) == fifo, "side 1 read before reply (fifo %d)" % fifo)
+    for i in range(TRACKS * SIDES):
+        if i > 0:
+            t, body = peer.packet()
+            check(t == b"T", "track")
+        peer.send(packet(b"K"))
+    t, body = peer.packet()
+    check(t == b"E", "end")
+    peer.send(packet(b"K"))
+    check(p.wait(timeout=30) == 0, "sender result")
+    p.stdout.close()
+    os.close(master)
+
+
+def relay(a, b, stop):
+    while not stop.is_set():
+        r, _, _ = select.select([a, b], [], [], 0.1)
+        for fd in r:
+            try:
+                data = os.read(fd, 65536)
+            except OSError:
+                return
+            os.write(b if fd == a else a, data)
+
+
+def test_both():
+    # real receiver against the real sender
+    ma, na = open_pty()
+    mb, nb = open_pty()
+    stop = threading.Event()
+    t = threading.Thread(target=relay, args=(ma, mb, stop))
+    t.start()
+    out = os.path.join(HERE, "link_test.img")
+    recv = subprocess.Popen(FLOMPY + ["-m", "recv", "-c", na, "-f", "0xEE", out],
+        stdout=subprocess.DEVNULL)
+    env = dict(os.environ, FAKE_CORRUPT="0:1:3,0:1:7,1:0:9", FAKE_UNREADABLE="0:1:7",
+        FAKE_SHIFTED="1:1:5")
+    send = subprocess.Popen(FLOMPY + ["-m", "send", "-c", nb] + GEOMETRY,
+        env=env, stdout=subprocess.DEVNULL)
+    check(send.wait(timeout=60) == 0, "sender result")
+    check(recv.wait(timeout=60) == 7, "receiver reports the unrecovered sector")
+    stop.set()
+    t.join()
+    img = open(out, "rb").read()
+    os.remove(out)
+    check(len(img) == TRACKS * SIDES * SECTORS * BYTES, "image size")
+    pos = 0
+    for c in range(TRACKS):
+        for h in range(SIDES):
+            for r in range(1, SECTORS+1):
+                expect = bytes([0xEE] * BYTES) if (c, h, r) == (0, 1, 7) else sector(c, h, r)
+                check(img[pos:pos+BYTES] == expect, "image sector %d:%d:%d" % (c, h, r))
+                pos += BYTES
+    os.close(ma)
+    os.close(mb)
+
+
+def test_receiver_idle():
+    # sender that stops partway, built with a short LINK_IDLE
+    master, name = open_pty()
+    peer = Peer(master)
+    out = os.path.join(HERE, "link_test.img")
+    p = subprocess.Popen(FLOMPY + ["-m", "recv", "-c", name, out],
+        stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    time.sleep(0.5)
+    peer.send(packet(b"G" + bytes([2, 2, 18]) + struct.pack("<H", 512)))
+    check(peer.packet() == (b"K", b""), "geometry accepted")
+    # the reply to a track must fit a 16 byte UART FIFO
+    peer.send(packet(b"T" + bytes([0, 0]) + struct.pack("<I", 0)))
+    t, body = peer.packet()
+    check(t == b"R" and body == bytes([12]) + bytes(range(1, 13)), "first re-read request fits FIFO")
+    s = b"S" + bytes([0, 0, 12])
+    for r in range(1, 13):
+        s += bytes([r, 0]) + sector(0, 0, r)
+    peer.send(packet(s))
+    t, body = peer.packet()
+    check(t == b"R" and body == bytes([6]) + bytes(range(13, 19)), "remaining sectors named after re-read")
+    check(p.wait(timeout=30) == 11, "receiver gives up with RESULT_LINK")
+    img = open(out, "rb").read()
+    os.remove(out)
+    check(len(img) == 18 * BYTES, "pending track written")
+    check(img[0:BYTES] == sector(0, 0, 1), "re-read sector kept")
+    os.close(master)
+
+
+test_sender()
+test_sender_fifo(True)
+test_sender_fifo(False)
+test_both()
+test_receiver_idle()
+if failures:
+    print("%d failures." % failures)
+    sys.exit(1)
+print("Link tests passed.")
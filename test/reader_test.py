@@ -0,0 +1,169 @@
+#
+# FLOMPY tests
+# Dump file reader tests for flompy.py.
+#
+# Writes small dumps in each format FLOMPY produces, and checks they read back.
+#
+
+import os
+import struct
+import sys
+import numpy
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, ".."))
+import flompy
+
+failures = 0
+
+
+def check(ok, text):
+    global failures
+    if not ok:
+        failures += 1
+        print("FAIL: " + text)
+
+
+def track_data(c, h, length):
+    return bytes(((c * 37) + (h * 5) + i) & 0xFF for i in range(length))
+
+
+def track_time(c, h, length):
+    return [(c * 100) + (h * 10) + (i * 32) for i in range(length)]
+
+
+def write_dump(name, tracks, single, timing):
+    # tracks: list of (c, h, length), written as mode_low_track_write does
+    with open(name, "wb") as f:
+        for (c, h, length) in tracks:
+            if not single:
+                f.write(bytes([c, h]))
+            f.write(struct.pack("<I", length))
+            f.write(track_data(c, h, length))
+            if timing:
+                f.write(struct.pack("<%dH" % length, *track_time(c, h, length)))
+
+
+def write_image(name, sector_bytes, track_sectors, sides, tracks, total=None, boot_sides=None, long_total=None):
+    b = bytearray(sector_bytes * track_sectors * sides * tracks)
+    for i in range(0x24, len(b)):
+        b[i] = i & 0xFF
+    if total is not None:
+        struct.pack_into("<H", b, 0x00B, sector_bytes)
+        struct.pack_into("<H", b, 0x013, total)
+        struct.pack_into("<H", b, 0x018, track_sectors)
+        struct.pack_into("<H", b, 0x01A, sides if boot_sides is None else boot_sides)
+        struct.pack_into("<I", b, 0x020, 0 if long_total is None else long_total)
+    open(name, "wb").write(b)
+    return bytes(b)
+
+
+def check_dump(name, tracks, single, timing):
+    d = flompy.TrackDump(name)
+    check(d.single == single, "%s single detected" % name)
+    check(d.timing == timing, "%s timing detected" % name)
+    check(len(d) == len(tracks), "%s track count" % name)
+    for (t, (c, h, length)) in zip(d, tracks):
+        check(t.track == (None if single else c), "%s track" % name)
+        check(t.side == (None if single else h), "%s side" % name)
+        check(bytes(t.data) == track_data(c, h, length), "%s %d:%d data" % (name, c, h))
+        check(length < 1 or numpy.shares_memory(t.data, d.raw), "%s data is a view" % name)
+        if timing:
+            check(list(t.time) == track_time(c, h, length), "%s %d:%d time" % (name, c, h))
+            check(length < 1 or numpy.shares_memory(t.time, d.raw), "%s time is a view" % name)
+        else:
+            check(t.time is None, "%s no time" % name)
+    # explicit parameters give the same result
+    e = flompy.TrackDump(name, timing=timing, single=single)
+    check(len(e) == len(d), "%s explicit parameters" % name)
+    del d, e
+
+
+def expect_error(f, text):
+    try:
+        f()
+    except ValueError:
+        return
+    check(False, text)
+
+
+def test_track_dumps():
+    name = os.path.join(HERE, "reader_test.flw")
+    tracks = [(0, 0, 100), (0, 1, 0), (1, 0, 37), (1, 1, 256)]
+    write_dump(name, tracks, False, False) # -m low
+    check_dump(name, tracks, False, False)
+    d = flompy.TrackDump(name)
+    check(bytes(d.track(1, 0).data) == track_data(1, 0, 37), "track lookup")
+    check(d.track(2, 0) is None, "missing track lookup")
+    del d
+    write_dump(name, tracks, False, True) # -m full
+    check_dump(name, tracks, False, True)
+    write_dump(name, [(0, 0, 300)], True, False) # -m track
+    check_dump(name, [(0, 0, 300)], True, False)
+    write_dump(name, [(0, 0, 300)], True, True) # -m ftrack
+    check_dump(name, [(0, 0, 300)], True, True)
+    write_dump(name, [(0, 0, 0)], True, True) # empty single track
+    d = flompy.TrackDump(name)
+    check(len(d) == 1 and len(d[0].data) == 0, "empty single track")
+    del d
+
+    # not track dumps
+    open(name, "wb").write(b"")
+    expect_error(lambda: flompy.TrackDump(name), "empty file")
+    open(name, "wb").write(b"\x00\x00\x05\x00\x00\x00abc")
+    expect_error(lambda: flompy.TrackDump(name), "truncated track")
+    open(name, "wb").write(bytes([0, 0]) + struct.pack("<I", flompy.MAX_TRACK_SIZE + 1))
+    expect_error(lambda: flompy.TrackDump(name), "oversized track")
+    os.remove(name)
+
+
+def test_sector_dumps():
+    name = os.path.join(HERE, "reader_test.img")
+
+    # geometry from the boot sector
+    img = write_image(name, 512, 9, 2, 80, total=1440)
+    s = flompy.SectorDump(name)
+    check((s.tracks, s.sides, s.track_sectors, s.sector_bytes) == (80, 2, 9, 512), "boot geometry")
+    check(len(s) == 1440, "sector count")
+    check(bytes(s.sector(1, 1, 9)) == img[((1*18) + 9 + 8) * 512:((1*18) + 9 + 9) * 512], "sector data")
+    check(numpy.shares_memory(s.sector(3, 0, 2), s.raw), "sector is a view")
+    check(sum(1 for _ in s) == 1440, "iteration")
+    del s
+
+    # total sectors at $020, and one side guessed from a small total
+    write_image(name, 512, 9, 2, 80, total=0, long_total=1440)
+    s = flompy.SectorDump(name)
+    check((s.tracks, s.sides) == (80, 2), "long total sectors")
+    del s
+    write_image(name, 512, 8, 1, 40, total=320, boot_sides=0)
+    s = flompy.SectorDump(name)
+    check((s.tracks, s.sides) == (40, 1), "one side from total")
+    del s
+    write_image(name, 512, 9, 1, 80, total=717, boot_sides=0) # rounded up to whole tracks
+    s = flompy.SectorDump(name)
+    check((s.tracks, s.sides) == (80, 1), "tracks rounded up")
+    del s
+
+    # file size overrides a boot sector track count that disagrees
+    write_image(name, 512, 9, 2, 40, total=1440)
+    s = flompy.SectorDump(name)
+    check(s.tracks == 40, "tracks from file size")
+    del s
+
+    # explicit geometry, no boot sector
+    write_image(name, 256, 16, 1, 3)
+    s = flompy.SectorDump(name, sector_bytes=256, track_sectors=16, sides=1, tracks=3)
+    check((s.tracks, s.sides, s.track_sectors, s.sector_bytes) == (3, 1, 16, 256), "explicit geometry")
+    del s
+    expect_error(lambda: flompy.SectorDump(name), "no sectors per track")
+    expect_error(lambda: flompy.SectorDump(name, sector_bytes=4096, track_sectors=1), "sector too large")
+    expect_error(lambda: flompy.SectorDump(name, sector_bytes=512, track_sectors=7, sides=1), "partial track")
+    os.remove(name)
+
+
+test_track_dumps()
+test_sector_dumps()
+if failures:
+    print("%d failures." % failures)
+    sys.exit(1)
+print("Reader tests passed.")